@@ -0,0 +1,223 @@
+#include "Checkpoint.h"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+const char CHECKPOINT_MAGIC[8] = {'P', 'E', 'C', 'K', 'P', 'T', 0, 0};
+
+std::runtime_error ioError(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+// Writes size bytes and syncs them; closes fd either way
+void writeAndSync(int fd, const char* data, size_t size, const std::string& path) {
+    size_t left = size;
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            ::close(fd);
+            throw ioError("cannot write", path);
+        }
+        data += written;
+        left -= written;
+    }
+    bool synced = ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !synced)
+        throw ioError("cannot flush", path);
+}
+}
+
+uint64_t checkpointChecksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+CheckpointBlob::CheckpointBlob() {
+    clear();
+}
+
+void CheckpointBlob::clear() {
+    bytes.resize(sizeof(CheckpointHeader));
+}
+
+void CheckpointBlob::append(const void* src, size_t size) {
+    size_t offset = bytes.size();
+    bytes.resize(offset + size);
+    if (size > 0)
+        std::memcpy(bytes.data() + offset, src, size);
+}
+
+void CheckpointBlob::seal() {
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.payloadSize = bytes.size() - sizeof(CheckpointHeader);
+    header.checksum = checkpointChecksum(bytes.data() + sizeof(CheckpointHeader), header.payloadSize);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+}
+
+CheckpointReader::CheckpointReader(const char* data, size_t size) {
+    CheckpointHeader header;
+    if (size < sizeof(header))
+        throw std::runtime_error("checkpoint truncated");
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("not a checkpoint");
+    if (header.version != CHECKPOINT_VERSION)
+        throw std::runtime_error("unsupported checkpoint version " + std::to_string(header.version));
+    if (header.payloadSize != size - sizeof(header))
+        throw std::runtime_error("checkpoint truncated");
+    cursor = data + sizeof(header);
+    end = data + size;
+    if (checkpointChecksum(cursor, header.payloadSize) != header.checksum)
+        throw std::runtime_error("checkpoint checksum mismatch");
+}
+
+void CheckpointReader::take(void* dst, size_t size) {
+    if (size > remaining())
+        throw std::runtime_error("checkpoint truncated");
+    if (size > 0)
+        std::memcpy(dst, cursor, size);
+    cursor += size;
+}
+
+void saveCheckpointFile(const std::string& path, const CheckpointBlob& blob) {
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw ioError("cannot open", tmp);
+    writeAndSync(fd, blob.data(), blob.size(), tmp);
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw ioError("cannot rename to", path);
+}
+
+std::vector<char> loadCheckpointFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw ioError("cannot open", path);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void appendCheckpointLog(const std::string& path, const CheckpointBlob& blob, bool trim, size_t length) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        throw ioError("cannot open", path);
+    if (trim && ::ftruncate(fd, length) != 0) {
+        ::close(fd);
+        throw ioError("cannot truncate", path);
+    }
+    // An empty blob only trims
+    writeAndSync(fd, blob.data(), blob.empty() ? 0 : blob.size(), path);
+}
+
+std::vector<CheckpointReader> readCheckpointLog(const std::vector<char>& log, size_t& validBytes) {
+    std::vector<CheckpointReader> records;
+    size_t offset = 0;
+    while (log.size() - offset >= sizeof(CheckpointHeader)) {
+        CheckpointHeader header;
+        std::memcpy(&header, log.data() + offset, sizeof(header));
+        size_t left = log.size() - offset - sizeof(header);
+        if (header.payloadSize > left)
+            break;
+        size_t recordSize = sizeof(header) + header.payloadSize;
+        try {
+            records.emplace_back(log.data() + offset, recordSize);
+        } catch (const std::runtime_error&) {
+            if (offset + recordSize < log.size())
+                throw;
+            break;
+        }
+        offset += recordSize;
+    }
+    validBytes = offset;
+    return records;
+}
+
+std::string checkpointLogPath(const std::string& path) {
+    return path + ".log";
+}
+
+AsyncCheckpointWriter::AsyncCheckpointWriter(const std::string& path)
+    : path(path), worker(&AsyncCheckpointWriter::run, this) {}
+
+AsyncCheckpointWriter::~AsyncCheckpointWriter() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return queued == 0; });
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+CheckpointSnapshot* AsyncCheckpointWriter::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error)
+        std::rethrow_exception(std::exchange(error, nullptr));
+    if (queued == 2)
+        return nullptr;
+    CheckpointSnapshot& snapshot = buffers[front];
+    snapshot.state.clear();
+    snapshot.log.clear();
+    snapshot.trimLog = false;
+    snapshot.logLength = 0;
+    return &snapshot;
+}
+
+void AsyncCheckpointWriter::submit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++queued;
+        front ^= 1;
+    }
+    wake.notify_one();
+}
+
+void AsyncCheckpointWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return queued == 0; });
+    if (error)
+        std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void AsyncCheckpointWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return queued > 0 || stopping; });
+        if (queued == 0)
+            return;
+
+        // The stepping thread only touches buffers[front], which is never the queued one
+        CheckpointSnapshot& snapshot = buffers[back];
+        lock.unlock();
+        std::exception_ptr failure;
+        try {
+            // Log first: the checkpoint file never refers to samples the log lacks
+            if (!snapshot.log.empty())
+                snapshot.log.seal();
+            if (!snapshot.log.empty() || snapshot.trimLog)
+                appendCheckpointLog(checkpointLogPath(path), snapshot.log, snapshot.trimLog, snapshot.logLength);
+            snapshot.state.seal();
+            saveCheckpointFile(path, snapshot.state);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        lock.lock();
+        if (failure)
+            error = failure;
+        back ^= 1;
+        --queued;
+        done.notify_all();
+    }
+}
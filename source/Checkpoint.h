@@ -0,0 +1,165 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Checkpoint blob layout (native endianness):
+//   Header { magic "PECKPT\0\0", version, payload size, FNV-1a 64 checksum of payload }
+//   payload, written field by field in the order the owner serializes it
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t payloadSize;
+    uint64_t checksum;
+};
+
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+uint64_t checkpointChecksum(const char* data, size_t size);
+
+// Growable write buffer for one checkpoint. clear() keeps the capacity, so
+// repeated snapshots of the same system do not allocate.
+class CheckpointBlob {
+public:
+    CheckpointBlob();
+
+    void clear();
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be trivially copyable");
+        append(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void writeVector(const std::vector<T>& values) {
+        write<uint64_t>(values.size());
+        writeArray(values.data(), values.size());
+    }
+
+    template <typename T>
+    void writeArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be trivially copyable");
+        append(values, count * sizeof(T));
+    }
+
+    // Fills in the header; call once the payload is complete
+    void seal();
+
+    const char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    bool empty() const { return bytes.size() == sizeof(CheckpointHeader); }
+
+private:
+    std::vector<char> bytes;
+    void append(const void* src, size_t size);
+};
+
+// Reads fields back in the order they were written. The constructor checks the
+// header and checksum; every read throws std::runtime_error on truncated data.
+class CheckpointReader {
+public:
+    CheckpointReader(const char* data, size_t size);
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint fields must be trivially copyable");
+        T value;
+        take(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void readVector(std::vector<T>& values) {
+        uint64_t count = read<uint64_t>();
+        if (count > remaining() / sizeof(T))
+            throw std::runtime_error("checkpoint truncated");
+        values.resize(count);
+        readArray(values.data(), count);
+    }
+
+    template <typename T>
+    void readArray(T* values, size_t count) {
+        take(values, count * sizeof(T));
+    }
+
+    size_t remaining() const { return end - cursor; }
+
+private:
+    const char* cursor;
+    const char* end;
+    void take(void* dst, size_t size);
+};
+
+// Writes the sealed blob to path with a single write() to a temporary file,
+// then renames it over path so a crash never leaves a half-written checkpoint.
+void saveCheckpointFile(const std::string& path, const CheckpointBlob& blob);
+std::vector<char> loadCheckpointFile(const std::string& path);
+
+// Appends the sealed blob as one record of the log at path, first cutting the
+// log to `length` bytes if trim is set
+void appendCheckpointLog(const std::string& path, const CheckpointBlob& blob, bool trim, size_t length);
+
+// Splits a log into its records. A torn last record (crash during an append)
+// is dropped; damage anywhere else throws std::runtime_error. validBytes is the
+// length of the intact records: cut the log back to it before appending again,
+// or the torn bytes end up in the middle.
+std::vector<CheckpointReader> readCheckpointLog(const std::vector<char>& log, size_t& validBytes);
+
+// Log that goes with the checkpoint at path
+std::string checkpointLogPath(const std::string& path);
+
+// One snapshot: `state` replaces the checkpoint file, `log` (if not empty) is
+// appended to the log next to it. Data that only grows, such as a trajectory,
+// goes in the log a piece at a time so each snapshot costs the same.
+struct CheckpointSnapshot {
+    CheckpointBlob state, log;
+    // Cut the log to logLength bytes before appending: 0 for a new run, the
+    // intact records after a restore
+    bool trimLog = false;
+    size_t logLength = 0;
+};
+
+// Double-buffered checkpointing: the stepping thread serializes into one buffer
+// while a background thread seals and writes the other one to disk. Snapshots
+// are written in the order they were submitted.
+class AsyncCheckpointWriter {
+public:
+    explicit AsyncCheckpointWriter(const std::string& path);
+    ~AsyncCheckpointWriter();
+
+    // Cleared buffers for the next snapshot, or nullptr while both buffers are
+    // taken, one being written and one queued (skip this snapshot rather than stall).
+    CheckpointSnapshot* acquire();
+
+    // Queues the acquired snapshot; the checksums are computed on the writer thread
+    void submit();
+
+    // Waits for every queued snapshot; rethrows a failed background write
+    void flush();
+
+private:
+    std::string path;
+    CheckpointSnapshot buffers[2];
+    int front = 0, back = 0; // next buffer to fill, next buffer to write
+    int queued = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::thread worker;
+
+    void run();
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,134 @@
+#include "Downsample.h"
+#include <cmath>
+
+Downsampler::Downsampler(Downsampling mode, size_t totalSamples, size_t width)
+    : mode(mode), totalSamples(totalSamples), width(width) {
+    if (mode == Downsampling::MinMax) {
+        bucketSize = width > 0 ? (totalSamples + width - 1) / width : totalSamples;
+        // Buckets of one or two samples would emit every sample anyway
+        passThrough = bucketSize <= 2;
+        outX.reserve(passThrough ? totalSamples : 2 * width);
+    } else {
+        passThrough = width < 3 || totalSamples <= width;
+        if (!passThrough) {
+            // First and last samples are kept; the rest split into width - 2 buckets
+            nextBucketEnd = bucketEnd(0);
+        }
+        outX.reserve(passThrough ? totalSamples : width);
+    }
+    outY.reserve(outX.capacity());
+}
+
+void Downsampler::emit(float x, float y) {
+    outX.push_back(x);
+    outY.push_back(y);
+}
+
+void Downsampler::push(float x, float y) {
+    size_t k = count++;
+    if (passThrough) {
+        emit(x, y);
+    } else if (mode == Downsampling::MinMax) {
+        if (inBucket == 0 || y < minY) { minX = x; minY = y; }
+        if (inBucket == 0 || y > maxY) { maxX = x; maxY = y; }
+        if (++inBucket == bucketSize)
+            flushMinMax();
+    } else if (k == 0) {
+        emit(x, y);
+        anchorX = x;
+        anchorY = y;
+    } else {
+        pushLttb(x, y);
+    }
+}
+
+void Downsampler::finish() {
+    if (passThrough)
+        return;
+
+    if (mode == Downsampling::MinMax) {
+        if (inBucket > 0)
+            flushMinMax();
+        return;
+    }
+
+    // The final sample is always kept; take it back out of whichever bucket holds it
+    std::vector<float>& lastX = nextX.empty() ? currentX : nextX;
+    std::vector<float>& lastY = nextY.empty() ? currentY : nextY;
+    if (lastX.empty())
+        return;
+    float endX = lastX.back(), endY = lastY.back();
+    lastX.pop_back();
+    lastY.pop_back();
+
+    if (!currentX.empty()) {
+        float cx = endX, cy = endY;
+        if (!nextX.empty()) {
+            cx = cy = 0.0f;
+            for (size_t i = 0; i < nextX.size(); ++i) { cx += nextX[i]; cy += nextY[i]; }
+            cx /= nextX.size();
+            cy /= nextX.size();
+        }
+        selectLttb(currentX, currentY, cx, cy);
+    }
+    if (!nextX.empty())
+        selectLttb(nextX, nextY, endX, endY);
+    emit(endX, endY);
+
+    currentX.clear(); currentY.clear();
+    nextX.clear(); nextY.clear();
+}
+
+void Downsampler::flushMinMax() {
+    // Keep x order so the polyline does not double back
+    if (minX == maxX) {
+        emit(minX, minY);
+    } else if (minX < maxX) {
+        emit(minX, minY);
+        emit(maxX, maxY);
+    } else {
+        emit(maxX, maxY);
+        emit(minX, minY);
+    }
+    inBucket = 0;
+}
+
+size_t Downsampler::bucketEnd(size_t bucket) const {
+    // Integer arithmetic, so the last bucket (width - 3) always ends at totalSamples - 1
+    return (bucket + 1) * (totalSamples - 2) / (width - 2) + 1;
+}
+
+void Downsampler::pushLttb(float x, float y) {
+    size_t k = count - 1;
+    while (k >= nextBucketEnd) {
+        // `next` is complete: its average decides which point of `current` survives
+        if (!currentX.empty() && !nextX.empty()) {
+            float cx = 0.0f, cy = 0.0f;
+            for (size_t i = 0; i < nextX.size(); ++i) { cx += nextX[i]; cy += nextY[i]; }
+            selectLttb(currentX, currentY, cx / nextX.size(), cy / nextX.size());
+        }
+        currentX.swap(nextX);
+        currentY.swap(nextY);
+        nextX.clear();
+        nextY.clear();
+        nextBucketEnd = bucketEnd(++nextBucket);
+    }
+    nextX.push_back(x);
+    nextY.push_back(y);
+}
+
+void Downsampler::selectLttb(const std::vector<float>& bx, const std::vector<float>& by, float cx, float cy) {
+    size_t best = 0;
+    float bestArea = -1.0f;
+    for (size_t i = 0; i < bx.size(); ++i) {
+        // Twice the area of the triangle (anchor, candidate, next-bucket average)
+        float area = std::abs((anchorX - cx) * (by[i] - anchorY) - (anchorX - bx[i]) * (cy - anchorY));
+        if (area > bestArea) {
+            bestArea = area;
+            best = i;
+        }
+    }
+    emit(bx[best], by[best]);
+    anchorX = bx[best];
+    anchorY = by[best];
+}
@@ -0,0 +1,48 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <vector>
+#include <cstddef>
+
+enum class Downsampling {
+    MinMax, // min and max of each bucket, up to 2 * width points; keeps every peak
+    LTTB    // largest-triangle-three-buckets, width points; keeps the visual shape
+};
+
+// Streaming reduction of an (x, y) series to the resolution of a plot `width` pixels wide.
+// Push the samples in x order, call finish(), then read xs() / ys(). At most two
+// buckets of samples are held at a time, never the whole series.
+class Downsampler {
+public:
+    Downsampler(Downsampling mode, size_t totalSamples, size_t width);
+
+    void push(float x, float y);
+    void finish();
+
+    const std::vector<float>& xs() const { return outX; }
+    const std::vector<float>& ys() const { return outY; }
+
+private:
+    Downsampling mode;
+    size_t totalSamples, width;
+    size_t count = 0;
+    bool passThrough;
+    std::vector<float> outX, outY;
+
+    void emit(float x, float y);
+
+    // MinMax: extremes of the bucket being filled
+    size_t bucketSize = 1, inBucket = 0;
+    float minX = 0, minY = 0, maxX = 0, maxY = 0;
+    void flushMinMax();
+
+    // LTTB: `current` waits for the average of `next` before one of its points is chosen
+    size_t nextBucket = 0, nextBucketEnd = 0;
+    float anchorX = 0, anchorY = 0;
+    std::vector<float> currentX, currentY, nextX, nextY;
+    void pushLttb(float x, float y);
+    void selectLttb(const std::vector<float>& bx, const std::vector<float>& by, float cx, float cy);
+    size_t bucketEnd(size_t bucket) const;
+};
+
+#endif // DOWNSAMPLE_H
@@ -0,0 +1,200 @@
+#include "ForceSchedule.h"
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+void ForceSchedule::addImpulse(int mass, float t, float impulse) {
+    impulses.push_back({mass, t, impulse});
+}
+
+void ForceSchedule::addStep(int mass, float tStart, float force, float tEnd) {
+    steps.push_back({mass, tStart, tEnd, force});
+}
+
+void ForceSchedule::addSinusoid(int mass, float amplitude, float omega, float phase, float tStart, float tEnd) {
+    sinusoids.push_back({mass, amplitude, omega, phase, tStart, tEnd});
+}
+
+void ForceSchedule::addPiecewiseLinear(int mass, const std::vector<float>& times, const std::vector<float>& forces) {
+    if (times.size() != forces.size() || times.empty())
+        throw std::invalid_argument("piecewise-linear force needs matching, non-empty time and force tables");
+    if (!std::is_sorted(times.begin(), times.end()))
+        throw std::invalid_argument("piecewise-linear force times must be sorted");
+    tables.push_back({mass, times, forces});
+}
+
+CompiledForceSchedule ForceSchedule::compile(int numMasses) const {
+    auto checkMass = [numMasses](int mass) {
+        if (mass < 0 || mass >= numMasses)
+            throw std::out_of_range("force schedule refers to mass " + std::to_string(mass));
+    };
+
+    CompiledForceSchedule c;
+    c.masses = numMasses;
+
+    // Sort impulses by time; stable so simultaneous impulses keep insertion order
+    std::vector<size_t> order(impulses.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](size_t a, size_t b) { return impulses[a].time < impulses[b].time; });
+    for (size_t idx : order) {
+        checkMass(impulses[idx].mass);
+        c.eventTimes.push_back(impulses[idx].time);
+        c.eventMasses.push_back(impulses[idx].mass);
+        c.eventImpulses.push_back(impulses[idx].impulse);
+    }
+
+    for (const Step& s : steps) {
+        checkMass(s.mass);
+        c.stepMasses.push_back(s.mass);
+        c.stepStarts.push_back(s.tStart);
+        c.stepEnds.push_back(s.tEnd);
+        c.stepForces.push_back(s.force);
+    }
+
+    for (const Sinusoid& s : sinusoids) {
+        checkMass(s.mass);
+        c.sineMasses.push_back(s.mass);
+        c.sineAmplitudes.push_back(s.amplitude);
+        c.sineOmegas.push_back(s.omega);
+        c.sinePhases.push_back(s.phase);
+        c.sineStarts.push_back(s.tStart);
+        c.sineEnds.push_back(s.tEnd);
+    }
+
+    c.tableOffsets.push_back(0);
+    for (const Table& tab : tables) {
+        checkMass(tab.mass);
+        c.tableMasses.push_back(tab.mass);
+        c.knotTimes.insert(c.knotTimes.end(), tab.times.begin(), tab.times.end());
+        c.knotForces.insert(c.knotForces.end(), tab.forces.begin(), tab.forces.end());
+        c.tableOffsets.push_back(c.knotTimes.size());
+    }
+
+    return c;
+}
+
+bool CompiledForceSchedule::empty() const {
+    return eventTimes.empty() && stepMasses.empty() && sineMasses.empty() && tableMasses.empty();
+}
+
+void CompiledForceSchedule::evaluate(float t, float* force) const {
+    std::fill(force, force + masses, 0.0f);
+
+    for (size_t j = 0; j < stepMasses.size(); ++j) {
+        float active = (t >= stepStarts[j] && t < stepEnds[j]) ? 1.0f : 0.0f;
+        force[stepMasses[j]] += active * stepForces[j];
+    }
+
+    for (size_t j = 0; j < sineMasses.size(); ++j) {
+        float active = (t >= sineStarts[j] && t < sineEnds[j]) ? 1.0f : 0.0f;
+        force[sineMasses[j]] += active * sineAmplitudes[j] * std::sin(sineOmegas[j] * t + sinePhases[j]);
+    }
+
+    for (size_t j = 0; j < tableMasses.size(); ++j) {
+        const float* first = knotTimes.data() + tableOffsets[j];
+        const float* last = knotTimes.data() + tableOffsets[j + 1];
+        if (t < *first || t > *(last - 1))
+            continue;
+        // Knot k is the first one strictly after t; interpolate on [k - 1, k]
+        const float* k = std::upper_bound(first, last, t);
+        size_t i = (k - knotTimes.data()) - 1;
+        float value = knotForces[i];
+        if (k != last) {
+            float alpha = (t - knotTimes[i]) / (knotTimes[i + 1] - knotTimes[i]);
+            value += alpha * (knotForces[i + 1] - knotForces[i]);
+        }
+        force[tableMasses[j]] += value;
+    }
+}
+
+size_t CompiledForceSchedule::firstImpulseFrom(float t) const {
+    return std::lower_bound(eventTimes.begin(), eventTimes.end(), t) - eventTimes.begin();
+}
+
+size_t CompiledForceSchedule::applyImpulses(size_t next, float tEnd, float* y, const float* inverseMasses) const {
+    for (; next < eventTimes.size() && eventTimes[next] < tEnd; ++next) {
+        int i = eventMasses[next];
+        y[2 * i + 1] += eventImpulses[next] * inverseMasses[i];
+    }
+    return next;
+}
+
+void CompiledForceSchedule::save(CheckpointBlob& blob) const {
+    blob.write<int32_t>(masses);
+    blob.writeVector(eventTimes);
+    blob.writeVector(eventMasses);
+    blob.writeVector(eventImpulses);
+    blob.writeVector(stepMasses);
+    blob.writeVector(stepStarts);
+    blob.writeVector(stepEnds);
+    blob.writeVector(stepForces);
+    blob.writeVector(sineMasses);
+    blob.writeVector(sineAmplitudes);
+    blob.writeVector(sineOmegas);
+    blob.writeVector(sinePhases);
+    blob.writeVector(sineStarts);
+    blob.writeVector(sineEnds);
+    blob.writeVector(tableMasses);
+    std::vector<uint64_t> offsets(tableOffsets.begin(), tableOffsets.end());
+    blob.writeVector(offsets);
+    blob.writeVector(knotTimes);
+    blob.writeVector(knotForces);
+}
+
+void CompiledForceSchedule::load(CheckpointReader& reader) {
+    CompiledForceSchedule c;
+    c.masses = reader.read<int32_t>();
+    reader.readVector(c.eventTimes);
+    reader.readVector(c.eventMasses);
+    reader.readVector(c.eventImpulses);
+    reader.readVector(c.stepMasses);
+    reader.readVector(c.stepStarts);
+    reader.readVector(c.stepEnds);
+    reader.readVector(c.stepForces);
+    reader.readVector(c.sineMasses);
+    reader.readVector(c.sineAmplitudes);
+    reader.readVector(c.sineOmegas);
+    reader.readVector(c.sinePhases);
+    reader.readVector(c.sineStarts);
+    reader.readVector(c.sineEnds);
+    reader.readVector(c.tableMasses);
+    std::vector<uint64_t> offsets;
+    reader.readVector(offsets);
+    c.tableOffsets.assign(offsets.begin(), offsets.end());
+    reader.readVector(c.knotTimes);
+    reader.readVector(c.knotForces);
+
+    auto massesValid = [&c](const std::vector<int>& indices) {
+        return std::all_of(indices.begin(), indices.end(), [&c](int i) { return i >= 0 && i < c.masses; });
+    };
+    size_t events = c.eventTimes.size(), steps = c.stepMasses.size(), sines = c.sineMasses.size();
+    bool valid = c.masses >= 0
+        && c.eventMasses.size() == events && c.eventImpulses.size() == events
+        && std::is_sorted(c.eventTimes.begin(), c.eventTimes.end()) && massesValid(c.eventMasses)
+        && c.stepStarts.size() == steps && c.stepEnds.size() == steps && c.stepForces.size() == steps
+        && massesValid(c.stepMasses)
+        && c.sineAmplitudes.size() == sines && c.sineOmegas.size() == sines && c.sinePhases.size() == sines
+        && c.sineStarts.size() == sines && c.sineEnds.size() == sines && massesValid(c.sineMasses)
+        && massesValid(c.tableMasses) && c.knotForces.size() == c.knotTimes.size();
+
+    // Tables: offsets start at 0, every table has a knot, the last one ends the knot array
+    if (c.tableOffsets.empty()) {
+        valid = valid && c.tableMasses.empty() && c.knotTimes.empty();
+    } else {
+        valid = valid && c.tableOffsets.size() == c.tableMasses.size() + 1 && c.tableOffsets.front() == 0
+            && c.tableOffsets.back() == c.knotTimes.size();
+        for (size_t j = 0; valid && j < c.tableMasses.size(); ++j) {
+            valid = c.tableOffsets[j] < c.tableOffsets[j + 1] && c.tableOffsets[j + 1] <= c.knotTimes.size()
+                && std::is_sorted(c.knotTimes.begin() + c.tableOffsets[j], c.knotTimes.begin() + c.tableOffsets[j + 1]);
+        }
+    }
+    if (!valid)
+        throw std::runtime_error("checkpoint force schedule is inconsistent");
+
+    *this = std::move(c);
+}
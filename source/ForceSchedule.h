@@ -0,0 +1,95 @@
+#ifndef FORCESCHEDULE_H
+#define FORCESCHEDULE_H
+
+#include <vector>
+#include <cstddef>
+
+class CompiledForceSchedule;
+class CheckpointBlob;
+class CheckpointReader;
+
+// Declarative description of the external forces acting on each mass.
+// Build it once, then compile() it into the flat form the integrator queries.
+class ForceSchedule {
+public:
+    // Instantaneous change of momentum J applied to a mass at time t (dv = J / m)
+    void addImpulse(int mass, float t, float impulse);
+
+    // Constant force F on [tStart, tEnd)
+    void addStep(int mass, float tStart, float force, float tEnd = 1e30f);
+
+    // F = amplitude * sin(omega * t + phase) on [tStart, tEnd)
+    void addSinusoid(int mass, float amplitude, float omega, float phase = 0.0f,
+                     float tStart = 0.0f, float tEnd = 1e30f);
+
+    // Linear interpolation through (times[k], forces[k]); zero outside the table
+    void addPiecewiseLinear(int mass, const std::vector<float>& times, const std::vector<float>& forces);
+
+    CompiledForceSchedule compile(int numMasses) const;
+
+private:
+    struct Impulse { int mass; float time, impulse; };
+    struct Step { int mass; float tStart, tEnd, force; };
+    struct Sinusoid { int mass; float amplitude, omega, phase, tStart, tEnd; };
+    struct Table { int mass; std::vector<float> times, forces; };
+
+    std::vector<Impulse> impulses;
+    std::vector<Step> steps;
+    std::vector<Sinusoid> sinusoids;
+    std::vector<Table> tables;
+};
+
+// Flattened schedule: impulses sorted by time, continuous terms stored as
+// structure-of-arrays so each kind is evaluated in one branch-free loop.
+// Queries never allocate.
+class CompiledForceSchedule {
+public:
+    bool empty() const;
+    int numMasses() const { return masses; }
+    size_t numImpulses() const { return eventTimes.size(); }
+
+    // Writes the continuous force on every mass at time t into force[0..numMasses)
+    void evaluate(float t, float* force) const;
+
+    // Index of the first impulse at or after t
+    size_t firstImpulseFrom(float t) const;
+
+    // Whether impulse `next` exists and is due before tEnd
+    bool impulseBefore(size_t next, float tEnd) const {
+        return next < eventTimes.size() && eventTimes[next] < tEnd;
+    }
+
+    // Adds dv = J / m for impulses next, next + 1, ... whose time is before tEnd and
+    // returns the index of the first one left unapplied. Callers keep that index as
+    // a cursor, so every impulse is consumed once regardless of how step ends round.
+    // y is the interleaved [x0, v0, x1, v1, ...] state vector.
+    size_t applyImpulses(size_t next, float tEnd, float* y, const float* inverseMasses) const;
+
+    // load() checks sizes, sort order and mass indices, and leaves *this
+    // unchanged if the checkpoint is inconsistent
+    void save(CheckpointBlob& blob) const;
+    void load(CheckpointReader& reader);
+
+private:
+    friend class ForceSchedule;
+
+    int masses = 0;
+
+    // Sorted event list
+    std::vector<float> eventTimes;
+    std::vector<int> eventMasses;
+    std::vector<float> eventImpulses;
+
+    std::vector<int> stepMasses;
+    std::vector<float> stepStarts, stepEnds, stepForces;
+
+    std::vector<int> sineMasses;
+    std::vector<float> sineAmplitudes, sineOmegas, sinePhases, sineStarts, sineEnds;
+
+    // Tables share one knot array; table j spans [tableOffsets[j], tableOffsets[j + 1])
+    std::vector<int> tableMasses;
+    std::vector<size_t> tableOffsets;
+    std::vector<float> knotTimes, knotForces;
+};
+
+#endif // FORCESCHEDULE_H
@@ -22,17 +22,27 @@ float MechanicalSystem::getSpringConstant() const { return springConstant; }
 MechanicalSystem::Vector MechanicalSystem::getInitialPosition() const { return initialPosition; }
 MechanicalSystem::Vector MechanicalSystem::getInitialVelocity() const { return initialVelocity; }
 
-void MechanicalSystem::setMass(float m) { mass = m; }
-void MechanicalSystem::setStiffness(float k) { springConstant = k; }
-void MechanicalSystem::setDamping(float c) { damping = c; }
+void MechanicalSystem::setMass(float m) {
+    mass = m;
+    massVersion.bump();
+}
+void MechanicalSystem::setStiffness(float k) {
+    springConstant = k;
+    stiffnessVersion.bump();
+}
+void MechanicalSystem::setDamping(float c) {
+    damping = c;
+    dampingVersion.bump();
+}
 
 MechanicalSystem::Vector MechanicalSystem::positionDerivative(float /*t*/, const Vector& /*x*/, const Vector& v) const {
     return v;
 }
 
 MechanicalSystem::Vector MechanicalSystem::velocityDerivative(float /*t*/, const Vector& x, const Vector& v) const {
-    // F = -kx - cv + externalForce + m*gravity
-    return (-getSpringConstant() * x - getDamping() * v + externalForce + mass * gravity) / getMass();
+    // a = (-kx - cv + externalForce) / m + gravity
+    float invMass = inverseMass.get(massVersion.generation(), [this](float& inv) { inv = 1.0f / mass; });
+    return (-getSpringConstant() * x - getDamping() * v + externalForce) * invMass + gravity;
 }
 
 MechanicalSystem::Vector MechanicalSystem::getVelocity(float t, const Vector& x, const Vector& v, float h) {
@@ -72,15 +82,18 @@ MechanicalSystem::Vector MechanicalSystem::rk4(Vector (*f)(float, const Vector&,
     return y + h / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
 }
 
-void MechanicalSystem::createPlot(float T) {
-    float t = 0.0;
+void MechanicalSystem::createPlot(float T, size_t pixelWidth, Downsampling mode) {
     float h = 0.1;
+    size_t samples = 0;
+    for (float t = 0.0; t <= T; t += h)
+        ++samples;
+
+    float t = 0.0;
     Vector y = initialPosition;
     Vector v = initialVelocity;
 
-    std::vector<float> timePoints;
-    std::vector<float> positionPoints;
-    std::vector<float> velocityPoints;
+    Downsampler positionPoints(mode, samples, pixelWidth);
+    Downsampler velocityPoints(mode, samples, pixelWidth);
 
     while (t <= T) {
         Vector currentPos = getPos(t, y, v, h);
@@ -90,13 +103,14 @@ void MechanicalSystem::createPlot(float T) {
         y = currentPos;
         v = currentVel;
         // For plotting, only plot the first dimension
-        positionPoints.push_back(currentPos[0]);
-        velocityPoints.push_back(currentVel[0]);
-        timePoints.push_back(t);
+        positionPoints.push(t, currentPos[0]);
+        velocityPoints.push(t, currentVel[0]);
     }
+    positionPoints.finish();
+    velocityPoints.finish();
 
-    plt::plot(timePoints, positionPoints, {{"label", "Position (dim 0)"}});
-    plt::plot(timePoints, velocityPoints, {{"label", "Velocity (dim 0)"}});
+    plt::plot(positionPoints.xs(), positionPoints.ys(), {{"label", "Position (dim 0)"}});
+    plt::plot(velocityPoints.xs(), velocityPoints.ys(), {{"label", "Velocity (dim 0)"}});
     plt::xlabel("Time");
     plt::ylabel("Value");
     plt::title("Trajectory of the Mass (First Dimension)");
@@ -4,6 +4,8 @@
 
 #include <vector>
 #include <Eigen/Dense>
+#include "Downsample.h"
+#include "ParameterCache.h"
 
 
 class MechanicalSystem {
@@ -30,13 +32,17 @@ public:
     void updateExternalForce(const Vector& force);
     void setGravity(const Vector& g); // New method
 
-    void createPlot(float T);
+    // Trajectory is downsampled while it is integrated, so only pixelWidth-sized series are kept
+    void createPlot(float T, size_t pixelWidth = 1000, Downsampling mode = Downsampling::MinMax);
 
     // RK4 and ODE solver
     Vector rk4(Vector (*f)(float, const Vector&, const MechanicalSystem&), float t, const Vector& y, float h, const MechanicalSystem& system);
 
 private:
     float mass, damping, springConstant;
+    // Every setter bumps its group; only the mass has derived data so far
+    ParameterVersion massVersion, dampingVersion, stiffnessVersion;
+    mutable Derived<float> inverseMass; // 1 / mass, rebuilt only after setMass
     Vector initialPosition, initialVelocity;
     Vector externalForce;
     Vector gravity; // New member
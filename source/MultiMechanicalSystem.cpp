@@ -2,15 +2,36 @@
 #include <vector>
 // Public RK4 step for a single integration step
 std::vector<float> MultiMechanicalSystem::step(float t, const std::vector<float>& y, float h) {
-    auto result = rk4([this](float t, const std::vector<float>& y) { return systemOde(t, y); }, t, y, h);
+    refreshDerived();
+
+    // Impulses not yet applied and due before t + h kick the velocities before the smooth update
+    const std::vector<float>* start = &y;
+    std::vector<float> kicked;
+    if (!forces.empty()) {
+        if (!(t > lastStepStart))
+            nextImpulse = forces.firstImpulseFrom(t);
+        lastStepStart = t;
+        // Copy the state only for the rare step that has an impulse in it
+        if (forces.impulseBefore(nextImpulse, t + h)) {
+            kicked = y;
+            nextImpulse = forces.applyImpulses(nextImpulse, t + h, kicked.data(), inverseMassCache.value().data());
+            start = &kicked;
+        }
+    }
+    auto result = rk4([this](float t, const std::vector<float>& y) { return systemOde(t, y); }, t, *start, h);
     return result[0];
 }
 
 // Public wrapper for ODE
 std::vector<float> MultiMechanicalSystem::systemOdePublic(float t, const std::vector<float>& y) {
+    refreshDerived();
     return systemOde(t, y);
 }
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <matplotlibcpp.h>
 
 namespace plt = matplotlibcpp;
@@ -26,10 +47,105 @@ MultiMechanicalSystem::MultiMechanicalSystem(const std::vector<float>& masses,
       initialPositions(initialPositions), initialVelocities(initialVelocities), 
       couplings(couplings), couplingConstants(couplingConstants) {
     numSystems = masses.size();
+    checkCouplings(couplings, couplingConstants);
+    invalidateDerived();
+}
+
+void MultiMechanicalSystem::checkCouplings(const std::vector<std::pair<int, int>>& couplings,
+                                           const std::vector<float>& couplingConstants) const {
+    if (couplings.size() != couplingConstants.size())
+        throw std::invalid_argument("couplings and coupling constants differ in length");
+    for (const auto& c : couplings) {
+        for (int mass : {c.first, c.second}) {
+            // refreshDerived indexes the adjacency rows by these
+            if (mass < 0 || mass >= numSystems)
+                throw std::invalid_argument("coupling refers to mass " + std::to_string(mass));
+        }
+    }
+}
+
+void MultiMechanicalSystem::setMass(int i, float m) {
+    masses[i] = m;
+    massVersion.bump();
+}
+
+void MultiMechanicalSystem::setDamping(int i, float c) {
+    dampings[i] = c;
+    dampingVersion.bump();
+}
+
+void MultiMechanicalSystem::setSpringConstant(int i, float k) {
+    springConstants[i] = k;
+    stiffnessVersion.bump();
+}
+
+void MultiMechanicalSystem::setCouplingConstant(int j, float k) {
+    couplingConstants[j] = k;
+    couplingVersion.bump();
+}
+
+void MultiMechanicalSystem::setCouplings(const std::vector<std::pair<int, int>>& couplings,
+                                         const std::vector<float>& couplingConstants) {
+    checkCouplings(couplings, couplingConstants);
+    this->couplings = couplings;
+    this->couplingConstants = couplingConstants;
+    couplingVersion.bump();
+}
+
+void MultiMechanicalSystem::invalidateDerived() {
+    massVersion.bump();
+    dampingVersion.bump();
+    stiffnessVersion.bump();
+    couplingVersion.bump();
+    externalForces.assign(numSystems, 0.0f);
+}
+
+void MultiMechanicalSystem::refreshDerived() {
+    inverseMassCache.get(massVersion.generation(), [this](std::vector<float>& inv) {
+        inv.resize(numSystems);
+        for (size_t i = 0; i < numSystems; ++i)
+            inv[i] = 1.0f / masses[i];
+    });
+
+    couplingCache.get(couplingVersion.generation(), [this](CouplingGraph& g) {
+        // Counting sort of coupling ends by mass keeps each row in coupling order
+        g.rowStart.assign(numSystems + 1, 0);
+        for (const auto& c : couplings) {
+            ++g.rowStart[c.first + 1];
+            if (c.second != c.first)
+                ++g.rowStart[c.second + 1];
+        }
+        for (size_t i = 0; i < numSystems; ++i)
+            g.rowStart[i + 1] += g.rowStart[i];
+
+        g.neighbours.resize(g.rowStart[numSystems]);
+        g.constants.resize(g.rowStart[numSystems]);
+        std::vector<int> fill(g.rowStart.begin(), g.rowStart.end() - 1);
+        for (size_t j = 0; j < couplings.size(); ++j) {
+            int a = couplings[j].first, b = couplings[j].second;
+            g.neighbours[fill[a]] = b;
+            g.constants[fill[a]++] = couplingConstants[j];
+            if (b != a) {
+                g.neighbours[fill[b]] = a;
+                g.constants[fill[b]++] = couplingConstants[j];
+            }
+        }
+    });
+}
+
+void MultiMechanicalSystem::setForceSchedule(const ForceSchedule& schedule) {
+    forces = schedule.compile(numSystems);
+    // systemOde only refreshes these while a schedule is set; do not let the old one linger
+    std::fill(externalForces.begin(), externalForces.end(), 0.0f);
+    rewindImpulses();
 }
 
 std::vector<float> MultiMechanicalSystem::systemOde(float t, const std::vector<float>& y) {
     std::vector<float> dydt(2 * numSystems, 0.0f);
+    if (!forces.empty())
+        forces.evaluate(t, externalForces.data());
+    const std::vector<float>& inverseMass = inverseMassCache.value();
+    const CouplingGraph& graph = couplingCache.value();
 
     for (size_t i = 0; i < numSystems; ++i) {
         float x = y[2 * i];         // Position
@@ -39,16 +155,12 @@ std::vector<float> MultiMechanicalSystem::systemOde(float t, const std::vector<f
 
         // Add coupling forces
         float couplingForce = 0.0f;
-        for (size_t j = 0; j < couplings.size(); ++j) {
-            if (couplings[j].first == i) {
-                couplingForce += -couplingConstants[j] * (x - y[2 * couplings[j].second]);
-            } else if (couplings[j].second == i) {
-                couplingForce += -couplingConstants[j] * (x - y[2 * couplings[j].first]);
-            }
+        for (int j = graph.rowStart[i]; j < graph.rowStart[i + 1]; ++j) {
+            couplingForce += -graph.constants[j] * (x - y[2 * graph.neighbours[j]]);
         }
 
         dydt[2 * i] = v; // dx/dt = velocity
-        dydt[2 * i + 1] = (springForce + dampingForce + couplingForce) / masses[i];
+        dydt[2 * i + 1] = (springForce + dampingForce + couplingForce + externalForces[i]) * inverseMass[i];
     }
 
     return dydt;
@@ -81,34 +193,248 @@ std::vector<std::vector<float>> MultiMechanicalSystem::rk4(std::function<std::ve
     return {y_next};
 }
 
+size_t MultiMechanicalSystem::numSteps(float T, float h) {
+    return T / h;
+}
+
 void MultiMechanicalSystem::simulate(float T, float h) {
-    size_t steps = T / h;
-    std::vector<float> y(2 * numSystems);
-    positions.assign(numSystems, std::vector<float>(steps));
-    velocities.assign(numSystems, std::vector<float>(steps));
+    beginSimulation(T, h);
+    advance(storedSteps);
+}
+
+void MultiMechanicalSystem::beginSimulation(float T, float h) {
+    storedSteps = numSteps(T, h);
+    storedTimeStep = h;
+    positions.resize(numSystems * storedSteps);
+    velocities.resize(numSystems * storedSteps);
 
+    runStep = 0;
+    checkpointedStep = 0;
+    trimLog = true;
+    logLength = 0;
+    rewindImpulses();
+    runState.resize(2 * numSystems);
     for (size_t i = 0; i < numSystems; ++i) {
-        y[2 * i] = initialPositions[i];
-        y[2 * i + 1] = initialVelocities[i];
-        positions[i][0] = initialPositions[i];
-        velocities[i][0] = initialVelocities[i];
+        runState[2 * i] = initialPositions[i];
+        runState[2 * i + 1] = initialVelocities[i];
     }
+}
 
-    for (size_t step = 1; step < steps; ++step) {
-        float t = step * h;
-        auto nextState = rk4([this](float t, const std::vector<float>& y) { return systemOde(t, y); }, t, y, h);
-        y = nextState[0];
+size_t MultiMechanicalSystem::advance(size_t maxSteps) {
+    size_t first = runStep;
+    size_t end = std::min(storedSteps, runStep + maxSteps);
+    for (; runStep < end; ++runStep) {
+        // Same step times as forEachSample, so chunked and one-shot runs agree exactly
+        if (runStep > 0)
+            runState = step((runStep - 1) * storedTimeStep, runState, storedTimeStep);
 
         for (size_t i = 0; i < numSystems; ++i) {
-            positions[i][step] = y[2 * i];
-            velocities[i][step] = y[2 * i + 1];
+            positions[i * storedSteps + runStep] = runState[2 * i];
+            velocities[i * storedSteps + runStep] = runState[2 * i + 1];
+        }
+    }
+    return runStep - first;
+}
+
+void MultiMechanicalSystem::simulate(float T, float h, AsyncCheckpointWriter& checkpoints, size_t interval) {
+    if (interval == 0)
+        throw std::invalid_argument("checkpoint interval must be at least one sample");
+    beginSimulation(T, h);
+    resume(checkpoints, interval);
+}
+
+void MultiMechanicalSystem::resume(AsyncCheckpointWriter& checkpoints, size_t interval) {
+    // advance(0) would never finish the run
+    if (interval == 0)
+        throw std::invalid_argument("checkpoint interval must be at least one sample");
+    while (!finished()) {
+        advance(interval);
+        if (CheckpointSnapshot* snapshot = checkpoints.acquire()) {
+            fillSnapshot(*snapshot);
+            checkpoints.submit();
         }
     }
+
+    // The last periodic snapshot may have been skipped; the file must end at the finished run
+    checkpoints.flush();
+    if (checkpointedStep != runStep) {
+        fillSnapshot(*checkpoints.acquire());
+        checkpoints.submit();
+        checkpoints.flush();
+    }
 }
 
-void MultiMechanicalSystem::createPlot() {
+void MultiMechanicalSystem::fillSnapshot(CheckpointSnapshot& snapshot) {
+    // Only the samples since the last snapshot, so every snapshot costs the same
+    snapshot.trimLog = trimLog;
+    snapshot.logLength = logLength;
+    trimLog = false;
+    saveState(snapshot.state);
+    saveSamples(snapshot.log, checkpointedStep);
+    checkpointedStep = runStep;
+}
+
+void MultiMechanicalSystem::saveState(CheckpointBlob& blob) const {
+    blob.write<int32_t>(numSystems);
+    blob.writeVector(masses);
+    blob.writeVector(dampings);
+    blob.writeVector(springConstants);
+    blob.writeVector(initialPositions);
+    blob.writeVector(initialVelocities);
+    std::vector<int32_t> couplingEnds;
+    for (const auto& c : couplings) {
+        couplingEnds.push_back(c.first);
+        couplingEnds.push_back(c.second);
+    }
+    blob.writeVector(couplingEnds);
+    blob.writeVector(couplingConstants);
+    forces.save(blob);
+
+    blob.write<uint64_t>(storedSteps);
+    blob.write(storedTimeStep);
+    blob.write<uint64_t>(runStep);
+    blob.writeVector(runState);
+    blob.write<uint64_t>(nextImpulse);
+    blob.write(lastStepStart);
+}
+
+void MultiMechanicalSystem::saveSamples(CheckpointBlob& blob, size_t firstStep) const {
+    if (firstStep >= runStep)
+        return;
+    size_t count = runStep - firstStep;
+    blob.write<uint64_t>(firstStep);
+    blob.write<uint64_t>(count);
+    blob.write<int32_t>(numSystems);
+    blob.write<uint64_t>(storedSteps);
     for (size_t i = 0; i < numSystems; ++i) {
-        plt::plot(positions[i], {{"label", "System " + std::to_string(i)}});
+        blob.writeArray(positions.data() + i * storedSteps + firstStep, count);
+        blob.writeArray(velocities.data() + i * storedSteps + firstStep, count);
+    }
+}
+
+void MultiMechanicalSystem::loadState(CheckpointReader& reader, const std::vector<char>& log) {
+    // Everything is read and checked into locals first, so a bad checkpoint leaves *this untouched
+    int n = reader.read<int32_t>();
+    std::vector<float> newMasses, newDampings, newSpringConstants, newInitialPositions, newInitialVelocities;
+    reader.readVector(newMasses);
+    reader.readVector(newDampings);
+    reader.readVector(newSpringConstants);
+    reader.readVector(newInitialPositions);
+    reader.readVector(newInitialVelocities);
+    std::vector<int32_t> couplingEnds;
+    reader.readVector(couplingEnds);
+    std::vector<float> newCouplingConstants;
+    reader.readVector(newCouplingConstants);
+    CompiledForceSchedule newForces;
+    newForces.load(reader);
+
+    size_t newStoredSteps = reader.read<uint64_t>();
+    float newStoredTimeStep = reader.read<float>();
+    size_t newRunStep = reader.read<uint64_t>();
+    std::vector<float> newRunState;
+    reader.readVector(newRunState);
+    size_t newNextImpulse = reader.read<uint64_t>();
+    float newLastStepStart = reader.read<float>();
+
+    size_t count = n < 0 ? 0 : size_t(n);
+    if (n < 0 || newMasses.size() != count || newDampings.size() != count || newSpringConstants.size() != count
+        || newInitialPositions.size() != count || newInitialVelocities.size() != count)
+        throw std::runtime_error("checkpoint parameters do not match the number of masses");
+    if (couplingEnds.size() != 2 * newCouplingConstants.size())
+        throw std::runtime_error("checkpoint couplings are inconsistent");
+    std::vector<std::pair<int, int>> newCouplings;
+    for (size_t j = 0; j < couplingEnds.size(); j += 2) {
+        int a = couplingEnds[j], b = couplingEnds[j + 1];
+        if (a < 0 || a >= n || b < 0 || b >= n)
+            throw std::runtime_error("checkpoint coupling refers to a missing mass");
+        newCouplings.emplace_back(a, b);
+    }
+    if (newForces.numMasses() != n && !newForces.empty())
+        throw std::runtime_error("checkpoint force schedule does not match the number of masses");
+    // A system that never began a run has no run state
+    bool hasRunState = newRunState.size() == 2 * count || (newRunStep == 0 && newRunState.empty());
+    if (newRunStep > newStoredSteps || !hasRunState || newNextImpulse > newForces.numImpulses())
+        throw std::runtime_error("checkpoint run state is inconsistent");
+
+    std::vector<float> newPositions(count * newStoredSteps), newVelocities(count * newStoredSteps);
+
+    // Records in append order; a later record overwrites the samples it repeats
+    size_t covered = 0, validLogBytes = 0;
+    for (CheckpointReader& record : readCheckpointLog(log, validLogBytes)) {
+        size_t first = record.read<uint64_t>();
+        size_t samples = record.read<uint64_t>();
+        if (record.read<int32_t>() != n || record.read<uint64_t>() != newStoredSteps
+            || first > newStoredSteps || samples > newStoredSteps - first)
+            throw std::runtime_error("checkpoint log does not match the checkpoint");
+        for (size_t i = 0; i < count; ++i) {
+            record.readArray(newPositions.data() + i * newStoredSteps + first, samples);
+            record.readArray(newVelocities.data() + i * newStoredSteps + first, samples);
+        }
+        if (first <= covered)
+            covered = std::max(covered, first + samples);
+    }
+    if (covered < newRunStep)
+        throw std::runtime_error("checkpoint log is missing samples");
+
+    numSystems = n;
+    masses = std::move(newMasses);
+    dampings = std::move(newDampings);
+    springConstants = std::move(newSpringConstants);
+    initialPositions = std::move(newInitialPositions);
+    initialVelocities = std::move(newInitialVelocities);
+    couplings = std::move(newCouplings);
+    couplingConstants = std::move(newCouplingConstants);
+    forces = std::move(newForces);
+    storedSteps = newStoredSteps;
+    storedTimeStep = newStoredTimeStep;
+    runStep = newRunStep;
+    runState = std::move(newRunState);
+    nextImpulse = newNextImpulse;
+    lastStepStart = newLastStepStart;
+    positions = std::move(newPositions);
+    velocities = std::move(newVelocities);
+    checkpointedStep = runStep;
+    // Appending after a torn record would bury it mid-log; drop it before the next snapshot
+    trimLog = true;
+    logLength = validLogBytes;
+
+    invalidateDerived();
+}
+
+void MultiMechanicalSystem::simulateInto(float T, float h, float* positionsOut, float* velocitiesOut) {
+    size_t steps = numSteps(T, h);
+    forEachSample(T, h, [&](size_t step, const std::vector<float>& y) {
+        for (size_t i = 0; i < numSystems; ++i) {
+            positionsOut[i * steps + step] = y[2 * i];
+            velocitiesOut[i * steps + step] = y[2 * i + 1];
+        }
+    });
+}
+
+void MultiMechanicalSystem::createPlot(size_t pixelWidth, Downsampling mode) {
+    std::vector<Downsampler> series(numSystems, Downsampler(mode, storedSteps, pixelWidth));
+    for (size_t i = 0; i < numSystems; ++i) {
+        const float* x = positions.data() + i * storedSteps;
+        for (size_t step = 0; step < storedSteps; ++step)
+            series[i].push(step * storedTimeStep, x[step]);
+    }
+    showPlot(series);
+}
+
+void MultiMechanicalSystem::simulateAndPlot(float T, float h, size_t pixelWidth, Downsampling mode) {
+    std::vector<Downsampler> series(numSystems, Downsampler(mode, numSteps(T, h), pixelWidth));
+    forEachSample(T, h, [&](size_t step, const std::vector<float>& y) {
+        for (size_t i = 0; i < numSystems; ++i)
+            series[i].push(step * h, y[2 * i]);
+    });
+    showPlot(series);
+}
+
+void MultiMechanicalSystem::showPlot(std::vector<Downsampler>& series) {
+    // One Python call per mass, each with at most a few points per pixel
+    for (size_t i = 0; i < series.size(); ++i) {
+        series[i].finish();
+        plt::plot(series[i].xs(), series[i].ys(), {{"label", "System " + std::to_string(i)}});
     }
     plt::legend();
     plt::show();
@@ -4,6 +4,11 @@
 
 #include <vector>
 #include <functional>
+#include <limits>
+#include "ForceSchedule.h"
+#include "Downsample.h"
+#include "Checkpoint.h"
+#include "ParameterCache.h"
 
 class MultiMechanicalSystem {
 public:
@@ -16,7 +21,49 @@ public:
                           const std::vector<float>& couplingConstants);
 
     void simulate(float T, float h);
-    void createPlot();
+
+    // Resumable form of simulate(T, h): beginSimulation, then advance() in chunks
+    void beginSimulation(float T, float h);
+    size_t advance(size_t maxSteps); // returns the number of samples produced
+    bool finished() const { return runStep >= storedSteps; }
+
+    // Runs the current simulation to the end, snapshotting every `interval` (> 0) samples.
+    // Snapshots are skipped, not waited for, while both writer buffers are busy; the
+    // run always ends with a snapshot of its final state.
+    void simulate(float T, float h, AsyncCheckpointWriter& checkpoints, size_t interval);
+    void resume(AsyncCheckpointWriter& checkpoints, size_t interval);
+
+    // Parameters, coupling graph, force schedule and run state; its size does not grow with the run.
+    // The trajectory goes to the checkpoint log instead, saveSamples appending the samples
+    // [firstStep, runStep) as one record. loadState restores both byte for byte, so a
+    // resumed run matches an uninterrupted one.
+    void saveState(CheckpointBlob& blob) const;
+    void saveSamples(CheckpointBlob& blob, size_t firstStep) const;
+    void loadState(CheckpointReader& reader, const std::vector<char>& log);
+
+    // Plots the stored trajectory reduced to pixelWidth buckets per mass
+    void createPlot(size_t pixelWidth = 1000, Downsampling mode = Downsampling::MinMax);
+
+    // Simulates and downsamples on the fly, without storing the trajectory, then plots
+    void simulateAndPlot(float T, float h, size_t pixelWidth = 1000, Downsampling mode = Downsampling::MinMax);
+
+    // Runs simulate(T, h) into caller-owned buffers of numSystems * numSteps(T, h) floats,
+    // laid out [mass][step]. Does not touch the stored trajectory.
+    void simulateInto(float T, float h, float* positionsOut, float* velocitiesOut);
+    static size_t numSteps(float T, float h);
+
+    int size() const { return numSystems; }
+
+    // Parameter setters. Derived data (inverse masses, coupling adjacency) is
+    // marked stale here and rebuilt once, at the start of the next step.
+    void setMass(int i, float m);
+    void setDamping(int i, float c);
+    void setSpringConstant(int i, float k);
+    void setCouplingConstant(int j, float k);
+    void setCouplings(const std::vector<std::pair<int, int>>& couplings, const std::vector<float>& couplingConstants);
+
+    // External forces; the schedule is compiled once here and queried inside every RK4 stage
+    void setForceSchedule(const ForceSchedule& schedule);
 
     // Public wrapper for ODE
     std::vector<float> systemOdePublic(float t, const std::vector<float>& y);
@@ -31,6 +78,36 @@ private:
     std::vector<std::pair<int, int>> couplings;
     std::vector<float> couplingConstants;
 
+    // Generations of the parameter groups; every setter bumps its group, whether or
+    // not anything is derived from it yet (systemOde reads dampings and springs directly)
+    ParameterVersion massVersion, dampingVersion, stiffnessVersion, couplingVersion;
+
+    // Couplings as compressed sparse rows: neighbours of mass i are
+    // neighbours[rowStart[i] .. rowStart[i + 1]), in coupling order
+    struct CouplingGraph {
+        std::vector<int> rowStart, neighbours;
+        std::vector<float> constants;
+    };
+    Derived<std::vector<float>> inverseMassCache;
+    Derived<CouplingGraph> couplingCache;
+
+    // Throws std::invalid_argument unless every coupling has a constant and joins existing masses
+    void checkCouplings(const std::vector<std::pair<int, int>>& couplings,
+                        const std::vector<float>& couplingConstants) const;
+
+    // Brings the caches up to date; systemOde reads them through value()
+    void refreshDerived();
+    void invalidateDerived();
+
+    CompiledForceSchedule forces;
+    std::vector<float> externalForces; // scratch for forces.evaluate, sized numSystems
+
+    // Impulse cursor: impulses before nextImpulse have been applied. A step that does
+    // not start after lastStepStart (new run, reset, repeated query) re-seeks it.
+    size_t nextImpulse = 0;
+    float lastStepStart = std::numeric_limits<float>::infinity();
+    void rewindImpulses() { lastStepStart = std::numeric_limits<float>::infinity(); }
+
     std::vector<std::vector<float>> rk4(std::function<std::vector<float>(float, const std::vector<float>&)> f, 
                                         float t, 
                                         const std::vector<float>& y, 
@@ -38,7 +115,49 @@ private:
 
     std::vector<float> systemOde(float t, const std::vector<float>& y);
 
-    std::vector<std::vector<float>> positions, velocities;
+    // Trajectory of the last simulate() call, [mass][step] with storedSteps samples per mass
+    std::vector<float> positions, velocities;
+    size_t storedSteps = 0;
+    float storedTimeStep = 0.0f;
+
+    // State of the run in progress: samples [0, runStep) are stored, runState is sample runStep - 1
+    size_t runStep = 0;
+    std::vector<float> runState;
+
+    // Samples [0, checkpointedStep) are already in the checkpoint log. The next snapshot
+    // first cuts the log to logLength bytes if trimLog is set (new run, or restore).
+    size_t checkpointedStep = 0;
+    bool trimLog = true;
+    size_t logLength = 0;
+    void fillSnapshot(CheckpointSnapshot& snapshot);
+
+    // Integrates from the initial state, calling sink(step, y) for every sample including step 0
+    template <typename Sink>
+    void forEachSample(float T, float h, Sink&& sink);
+
+    void showPlot(std::vector<Downsampler>& series);
 };
 
+template <typename Sink>
+void MultiMechanicalSystem::forEachSample(float T, float h, Sink&& sink) {
+    size_t steps = numSteps(T, h);
+    if (steps == 0)
+        return;
+
+    rewindImpulses();
+    std::vector<float> y(2 * numSystems);
+    for (int i = 0; i < numSystems; ++i) {
+        y[2 * i] = initialPositions[i];
+        y[2 * i + 1] = initialVelocities[i];
+    }
+    sink(size_t(0), y);
+
+    for (size_t step = 1; step < steps; ++step) {
+        // Advancing from sample step - 1, so the step starts at (step - 1) * h
+        float t = (step - 1) * h;
+        y = this->step(t, y, h);
+        sink(step, y);
+    }
+}
+
 #endif // MULTIMECHANICALSYSTEM_H
@@ -0,0 +1,38 @@
+#ifndef PARAMETERCACHE_H
+#define PARAMETERCACHE_H
+
+#include <cstdint>
+
+// Generation counter for one group of parameters. Setters bump it; derived
+// data remembers the generation it was built from.
+class ParameterVersion {
+public:
+    uint64_t generation() const { return value; }
+    void bump() { ++value; }
+
+private:
+    uint64_t value = 1;
+};
+
+// Data derived from a parameter group, rebuilt lazily when stale.
+template <typename T>
+class Derived {
+public:
+    template <typename Build>
+    const T& get(uint64_t sourceGeneration, Build&& build) {
+        if (builtAt != sourceGeneration) {
+            build(cached);
+            builtAt = sourceGeneration;
+        }
+        return cached;
+    }
+
+    // Last built value, without a staleness check
+    const T& value() const { return cached; }
+
+private:
+    T cached{};
+    uint64_t builtAt = 0;
+};
+
+#endif // PARAMETERCACHE_H
@@ -12,6 +12,7 @@
 #include <Eigen/Dense>
 
 #include "MultiMechanicalSystem.h"
+#include "Checkpoint.h"
 #include "cuda_mass_spring.h"
 
 #ifndef M_PI
@@ -96,6 +97,55 @@ int draggedBlock = -1; // index of block being dragged, -1 if none
 float dragOffset = 0.0f;
 double lastMouseX = 0.0;
 
+// Session checkpoints: K saves (written in the background), L restores
+const std::string checkpointPath = "session.ckpt";
+AsyncCheckpointWriter sessionCheckpoints(checkpointPath);
+
+void saveSession() {
+    CheckpointSnapshot* snapshot = sessionCheckpoints.acquire();
+    if (!snapshot) {
+        std::cout << "Previous checkpoint still being written, skipped" << std::endl;
+        return;
+    }
+    // The viewer steps by hand and stores no trajectory, so the state alone is enough
+    CheckpointBlob& blob = snapshot->state;
+    multiSystem.saveState(blob);
+    blob.writeVector(positions);
+    blob.writeVector(velocities);
+    blob.write(simTime);
+    blob.write(oscillationStarted);
+    sessionCheckpoints.submit();
+    std::cout << "Checkpoint saved to " << checkpointPath << std::endl;
+}
+
+void loadSession() {
+    // A save may still be in flight; wait for it so L restores the latest K
+    sessionCheckpoints.flush();
+    std::vector<char> data = loadCheckpointFile(checkpointPath);
+    CheckpointReader reader(data.data(), data.size());
+
+    // Restore into copies; the viewer only switches over once the whole checkpoint checks out
+    MultiMechanicalSystem restored = multiSystem;
+    restored.loadState(reader, {});
+    std::vector<float> restoredPositions, restoredVelocities;
+    reader.readVector(restoredPositions);
+    reader.readVector(restoredVelocities);
+    float restoredTime = reader.read<float>();
+    bool restoredStarted = reader.read<bool>();
+    if (restored.size() != numMasses || restoredPositions.size() != size_t(numMasses)
+        || restoredVelocities.size() != size_t(numMasses))
+        throw std::runtime_error("checkpoint has " + std::to_string(restored.size()) + " masses, the viewer "
+                                 + std::to_string(numMasses));
+
+    multiSystem = std::move(restored);
+    positions = std::move(restoredPositions);
+    velocities = std::move(restoredVelocities);
+    simTime = restoredTime;
+    oscillationStarted = restoredStarted;
+    draggedBlock = -1;
+    std::cout << "Checkpoint restored from " << checkpointPath << std::endl;
+}
+
 // Function implementations
 float screenToWorldX(double screenX, int windowWidth) {
     // Convert screen coordinates to world coordinates
@@ -251,6 +301,7 @@ int main() {
     std::cout << "- Press Space to start/stop oscillation" << std::endl;
     std::cout << "- Press R to reset" << std::endl;
     std::cout << "- Click and drag masses to interact" << std::endl;
+    std::cout << "- Press K to save a checkpoint, L to restore it" << std::endl;
 
     float timeStep = 0.016f; // ~60 FPS
 
@@ -379,9 +430,13 @@ int main() {
         // Handle keyboard input
         static bool spacePressed = false;
         static bool rPressed = false;
+        static bool kPressed = false;
+        static bool lPressed = false;
         
         bool currentSpaceState = (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS);
         bool currentRState = (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS);
+        bool currentKState = (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS);
+        bool currentLState = (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS);
         
         if (currentSpaceState && !spacePressed) {
             oscillationStarted = !oscillationStarted;
@@ -395,8 +450,21 @@ int main() {
             draggedBlock = -1;
         }
         
+        try {
+            if (currentKState && !kPressed) {
+                saveSession();
+            }
+            if (currentLState && !lPressed) {
+                loadSession();
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Checkpoint failed: " << e.what() << std::endl;
+        }
+        
         spacePressed = currentSpaceState;
         rPressed = currentRState;
+        kPressed = currentKState;
+        lPressed = currentLState;
     }
 
     glfwDestroyWindow(window);
@@ -0,0 +1,439 @@
+// Python extension module: `import physics_engine`
+//
+// Exposes MultiMechanicalSystem and a batched dataset generator for PINN training.
+// Trajectories are returned as NumPy arrays that own the C++ buffers they were
+// simulated into (no copies, no temporary files).
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../MultiMechanicalSystem.h"
+
+namespace {
+
+const char* BUFFER_CAPSULE = "physics_engine.buffer";
+
+void freeBuffer(PyObject* capsule) {
+    delete[] static_cast<float*>(PyCapsule_GetPointer(capsule, BUFFER_CAPSULE));
+}
+
+// Hands ownership of data to a new float32 array; the buffer is freed with the array
+PyObject* wrapBuffer(float* data, int nd, npy_intp* dims) {
+    PyObject* array = PyArray_SimpleNewFromData(nd, dims, NPY_FLOAT32, data);
+    if (!array) {
+        delete[] data;
+        return nullptr;
+    }
+    PyObject* capsule = PyCapsule_New(data, BUFFER_CAPSULE, freeBuffer);
+    if (!capsule) {
+        Py_DECREF(array);
+        delete[] data;
+        return nullptr;
+    }
+    // Steals the capsule reference, also on failure
+    if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), capsule) < 0) {
+        Py_DECREF(array);
+        return nullptr;
+    }
+    return array;
+}
+
+// nullptr instead of an exception when the buffer cannot be allocated
+float* allocateFloats(size_t count) {
+    if (count > size_t(std::numeric_limits<std::ptrdiff_t>::max()) / sizeof(float))
+        return nullptr;
+    return new (std::nothrow) float[count];
+}
+
+// Converts any array-like to a C-contiguous array of the given type and dimensionality
+PyArrayObject* asArray(PyObject* obj, int type, int ndim, const char* name) {
+    PyArrayObject* array = reinterpret_cast<PyArrayObject*>(
+        PyArray_FROM_OTF(obj, type, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST));
+    if (!array)
+        return nullptr;
+    // Empty Python lists come back as 1-D; treat them as zero rows
+    if (PyArray_NDIM(array) != ndim && !(PyArray_SIZE(array) == 0 && PyArray_NDIM(array) == 1)) {
+        PyErr_Format(PyExc_ValueError, "%s must be %d-dimensional", name, ndim);
+        Py_DECREF(array);
+        return nullptr;
+    }
+    return array;
+}
+
+// RAII holder so early returns release converted arrays
+struct ArrayRef {
+    PyArrayObject* array = nullptr;
+    ~ArrayRef() { Py_XDECREF(array); }
+    const float* floats() const { return static_cast<const float*>(PyArray_DATA(array)); }
+    const int* ints() const { return static_cast<const int*>(PyArray_DATA(array)); }
+    npy_intp dim(int d) const { return d < PyArray_NDIM(array) ? PyArray_DIM(array, d) : 0; }
+};
+
+bool parseCouplings(PyObject* obj, std::vector<std::pair<int, int>>& couplings, int numMasses) {
+    ArrayRef pairs;
+    pairs.array = asArray(obj, NPY_INT32, 2, "couplings");
+    if (!pairs.array)
+        return false;
+    npy_intp count = PyArray_SIZE(pairs.array) == 0 ? 0 : pairs.dim(0);
+    if (count > 0 && pairs.dim(1) != 2) {
+        PyErr_SetString(PyExc_ValueError, "couplings must have shape (numCouplings, 2)");
+        return false;
+    }
+    couplings.clear();
+    for (npy_intp j = 0; j < count; ++j) {
+        int a = pairs.ints()[2 * j], b = pairs.ints()[2 * j + 1];
+        if (a < 0 || a >= numMasses || b < 0 || b >= numMasses) {
+            PyErr_Format(PyExc_IndexError, "coupling %zd refers to a mass out of range", (Py_ssize_t)j);
+            return false;
+        }
+        couplings.emplace_back(a, b);
+    }
+    return true;
+}
+
+bool checkTimes(float T, float h) {
+    if (!(h > 0.0f) || !(T >= 0.0f)) {
+        PyErr_SetString(PyExc_ValueError, "T must be non-negative and h positive");
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// physics_engine.MultiMechanicalSystem
+
+struct PyMultiSystem {
+    PyObject_HEAD
+    MultiMechanicalSystem* system;
+    // step() writes scratch buffers and caches inside the system, so calls that
+    // run with the GIL released must not overlap on one object
+    std::mutex* mutex;
+};
+
+PyObject* PyMultiSystem_new(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    PyObject* object = PyType_GenericNew(type, args, kwargs);
+    if (!object)
+        return nullptr;
+    PyMultiSystem* self = reinterpret_cast<PyMultiSystem*>(object);
+    self->mutex = new (std::nothrow) std::mutex;
+    if (!self->mutex) {
+        Py_DECREF(object);
+        return PyErr_NoMemory();
+    }
+    return object;
+}
+
+void PyMultiSystem_dealloc(PyMultiSystem* self) {
+    delete self->system;
+    delete self->mutex;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// Takes the object's mutex with the GIL released, so a thread that holds the
+// mutex while simulating without the GIL can always finish
+std::unique_lock<std::mutex> lockSystem(PyMultiSystem* self) {
+    std::unique_lock<std::mutex> lock(*self->mutex, std::defer_lock);
+    Py_BEGIN_ALLOW_THREADS
+    lock.lock();
+    Py_END_ALLOW_THREADS
+    return lock;
+}
+
+int PyMultiSystem_init(PyMultiSystem* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"masses", "dampings", "spring_constants", "initial_positions",
+                                     "initial_velocities", "couplings", "coupling_constants", nullptr};
+    PyObject *massesObj, *dampingsObj, *springsObj, *x0Obj, *v0Obj;
+    PyObject *couplingsObj = nullptr, *couplingConstantsObj = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOO|OO", const_cast<char**>(keywords),
+                                     &massesObj, &dampingsObj, &springsObj, &x0Obj, &v0Obj,
+                                     &couplingsObj, &couplingConstantsObj))
+        return -1;
+
+    PyObject* objects[] = {massesObj, dampingsObj, springsObj, x0Obj, v0Obj};
+    std::vector<float> values[5];
+    for (int p = 0; p < 5; ++p) {
+        ArrayRef a;
+        a.array = asArray(objects[p], NPY_FLOAT32, 1, keywords[p]);
+        if (!a.array)
+            return -1;
+        values[p].assign(a.floats(), a.floats() + PyArray_SIZE(a.array));
+        if (values[p].size() != values[0].size()) {
+            PyErr_Format(PyExc_ValueError, "%s must have one entry per mass", keywords[p]);
+            return -1;
+        }
+    }
+    int numMasses = values[0].size();
+
+    std::vector<std::pair<int, int>> couplings;
+    std::vector<float> couplingConstants;
+    if (couplingsObj && !parseCouplings(couplingsObj, couplings, numMasses))
+        return -1;
+    if (couplingConstantsObj) {
+        ArrayRef k;
+        k.array = asArray(couplingConstantsObj, NPY_FLOAT32, 1, "coupling_constants");
+        if (!k.array)
+            return -1;
+        couplingConstants.assign(k.floats(), k.floats() + PyArray_SIZE(k.array));
+    }
+    if (couplingConstants.size() != couplings.size()) {
+        PyErr_SetString(PyExc_ValueError, "coupling_constants must have one entry per coupling");
+        return -1;
+    }
+
+    MultiMechanicalSystem* system;
+    try {
+        system = new MultiMechanicalSystem(values[0], values[1], values[2], values[3], values[4],
+                                           couplings, couplingConstants);
+    } catch (const std::bad_alloc&) {
+        PyErr_NoMemory();
+        return -1;
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return -1;
+    }
+
+    std::unique_lock<std::mutex> lock = lockSystem(self);
+    delete self->system;
+    self->system = system;
+    return 0;
+}
+
+bool checkInitialized(PyMultiSystem* self) {
+    if (!self->system) {
+        PyErr_SetString(PyExc_RuntimeError, "MultiMechanicalSystem.__init__ was not called");
+        return false;
+    }
+    return true;
+}
+
+// simulate(T, h) -> (positions, velocities), each float32 of shape (numMasses, numSteps)
+PyObject* PyMultiSystem_simulate(PyMultiSystem* self, PyObject* args) {
+    float T, h;
+    if (!checkInitialized(self) || !PyArg_ParseTuple(args, "ff", &T, &h) || !checkTimes(T, h))
+        return nullptr;
+
+    std::unique_lock<std::mutex> lock = lockSystem(self);
+    size_t steps = MultiMechanicalSystem::numSteps(T, h);
+    size_t count = self->system->size() > 0 && steps > std::numeric_limits<size_t>::max() / self->system->size()
+                       ? std::numeric_limits<size_t>::max() : self->system->size() * steps;
+    std::unique_ptr<float[]> positions(allocateFloats(count));
+    std::unique_ptr<float[]> velocities(allocateFloats(count));
+    if (!positions || !velocities)
+        return PyErr_NoMemory();
+
+    Py_BEGIN_ALLOW_THREADS
+    self->system->simulateInto(T, h, positions.get(), velocities.get());
+    Py_END_ALLOW_THREADS
+
+    npy_intp dims[2] = {self->system->size(), static_cast<npy_intp>(steps)};
+    PyObject* positionsArray = wrapBuffer(positions.release(), 2, dims);
+    if (!positionsArray)
+        return nullptr;
+    PyObject* velocitiesArray = wrapBuffer(velocities.release(), 2, dims);
+    if (!velocitiesArray) {
+        Py_DECREF(positionsArray);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", positionsArray, velocitiesArray);
+}
+
+// step(t, y, h) -> y after one RK4 step; y is interleaved [x0, v0, x1, v1, ...]
+PyObject* PyMultiSystem_step(PyMultiSystem* self, PyObject* args) {
+    float t, h;
+    PyObject* yObj;
+    if (!checkInitialized(self) || !PyArg_ParseTuple(args, "fOf", &t, &yObj, &h))
+        return nullptr;
+    ArrayRef y;
+    y.array = asArray(yObj, NPY_FLOAT32, 1, "y");
+    if (!y.array)
+        return nullptr;
+
+    std::unique_lock<std::mutex> lock = lockSystem(self);
+    if (PyArray_SIZE(y.array) != 2 * self->system->size()) {
+        PyErr_SetString(PyExc_ValueError, "y must hold a position and velocity per mass");
+        return nullptr;
+    }
+
+    std::vector<float> state(y.floats(), y.floats() + PyArray_SIZE(y.array));
+    state = self->system->step(t, state, h);
+    lock.unlock();
+
+    float* data = allocateFloats(state.size());
+    if (!data)
+        return PyErr_NoMemory();
+    std::copy(state.begin(), state.end(), data);
+    npy_intp dims[1] = {static_cast<npy_intp>(state.size())};
+    return wrapBuffer(data, 1, dims);
+}
+
+PyMethodDef PyMultiSystem_methods[] = {
+    {"simulate", reinterpret_cast<PyCFunction>(PyMultiSystem_simulate), METH_VARARGS,
+     "simulate(T, h) -> (positions, velocities) arrays of shape (num_masses, num_steps)"},
+    {"step", reinterpret_cast<PyCFunction>(PyMultiSystem_step), METH_VARARGS,
+     "step(t, y, h) -> state after one RK4 step"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyTypeObject PyMultiSystemType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// ---------------------------------------------------------------------------
+// physics_engine.generate_dataset
+
+// generate_dataset(masses, dampings, spring_constants, initial_positions, initial_velocities,
+//                  couplings, coupling_constants, T, h, threads=0)
+// Per-mass parameters have shape (batch, numMasses), coupling_constants (batch, numCouplings);
+// the coupling graph is shared. Returns (positions, velocities) of shape (batch, numMasses, numSteps).
+PyObject* generateDataset(PyObject* /*module*/, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"masses", "dampings", "spring_constants", "initial_positions",
+                                     "initial_velocities", "couplings", "coupling_constants",
+                                     "T", "h", "threads", nullptr};
+    PyObject *objects[5], *couplingsObj, *couplingConstantsObj;
+    float T, h;
+    int threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOOOOff|i", const_cast<char**>(keywords),
+                                     &objects[0], &objects[1], &objects[2], &objects[3], &objects[4],
+                                     &couplingsObj, &couplingConstantsObj, &T, &h, &threads))
+        return nullptr;
+    if (!checkTimes(T, h))
+        return nullptr;
+
+    ArrayRef params[5];
+    for (int p = 0; p < 5; ++p) {
+        params[p].array = asArray(objects[p], NPY_FLOAT32, 2, keywords[p]);
+        if (!params[p].array)
+            return nullptr;
+        if (params[p].dim(0) != params[0].dim(0) || params[p].dim(1) != params[0].dim(1)) {
+            PyErr_Format(PyExc_ValueError, "%s must have shape (batch, num_masses)", keywords[p]);
+            return nullptr;
+        }
+    }
+    npy_intp batch = params[0].dim(0);
+    int numMasses = params[0].dim(1);
+
+    std::vector<std::pair<int, int>> couplings;
+    if (!parseCouplings(couplingsObj, couplings, numMasses))
+        return nullptr;
+    int numCouplings = couplings.size();
+    ArrayRef couplingConstants;
+    couplingConstants.array = asArray(couplingConstantsObj, NPY_FLOAT32, 2, "coupling_constants");
+    if (!couplingConstants.array)
+        return nullptr;
+    if (numCouplings > 0 && (couplingConstants.dim(0) != batch || couplingConstants.dim(1) != numCouplings)) {
+        PyErr_SetString(PyExc_ValueError, "coupling_constants must have shape (batch, num_couplings)");
+        return nullptr;
+    }
+
+    size_t steps = MultiMechanicalSystem::numSteps(T, h);
+    size_t perSystem = static_cast<size_t>(numMasses) * steps;
+    size_t total = perSystem > 0 && size_t(batch) > std::numeric_limits<size_t>::max() / perSystem
+                       ? std::numeric_limits<size_t>::max() : batch * perSystem;
+    std::unique_ptr<float[]> positions(allocateFloats(total));
+    std::unique_ptr<float[]> velocities(allocateFloats(total));
+    if (!positions || !velocities)
+        return PyErr_NoMemory();
+
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<npy_intp>(threads, std::max<npy_intp>(batch, 1));
+
+    // Workers pull system indices from a shared counter; each one simulates
+    // straight into its slice of the output buffers.
+    std::atomic<npy_intp> next(0);
+    std::string error;
+    std::atomic<bool> failed(false);
+    auto worker = [&]() {
+        try {
+            for (npy_intp b = next++; b < batch && !failed; b = next++) {
+                auto row = [&](int p) {
+                    const float* start = params[p].floats() + b * numMasses;
+                    return std::vector<float>(start, start + numMasses);
+                };
+                const float* k = couplingConstants.floats() + b * numCouplings;
+                MultiMechanicalSystem system(row(0), row(1), row(2), row(3), row(4),
+                                             couplings, std::vector<float>(k, k + numCouplings));
+                system.simulateInto(T, h, positions.get() + b * perSystem, velocities.get() + b * perSystem);
+            }
+        } catch (const std::exception& e) {
+            if (!failed.exchange(true))
+                error = e.what();
+        }
+    };
+
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool)
+        thread.join();
+    Py_END_ALLOW_THREADS
+
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+
+    npy_intp dims[3] = {batch, numMasses, static_cast<npy_intp>(steps)};
+    PyObject* positionsArray = wrapBuffer(positions.release(), 3, dims);
+    if (!positionsArray)
+        return nullptr;
+    PyObject* velocitiesArray = wrapBuffer(velocities.release(), 3, dims);
+    if (!velocitiesArray) {
+        Py_DECREF(positionsArray);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", positionsArray, velocitiesArray);
+}
+
+PyMethodDef moduleMethods[] = {
+    {"generate_dataset", reinterpret_cast<PyCFunction>(generateDataset), METH_VARARGS | METH_KEYWORDS,
+     "Simulate a batch of parameterized systems in parallel; returns (positions, velocities)"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef moduleDef = {
+    PyModuleDef_HEAD_INIT, "physics_engine", "Mass-spring-damper simulations from the PhysicsEngine", -1, moduleMethods
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_physics_engine() {
+    import_array();
+
+    PyMultiSystemType.tp_name = "physics_engine.MultiMechanicalSystem";
+    PyMultiSystemType.tp_basicsize = sizeof(PyMultiSystem);
+    PyMultiSystemType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PyMultiSystemType.tp_doc = "Coupled 1D mass-spring-damper system integrated with RK4";
+    PyMultiSystemType.tp_new = PyMultiSystem_new;
+    PyMultiSystemType.tp_init = reinterpret_cast<initproc>(PyMultiSystem_init);
+    PyMultiSystemType.tp_dealloc = reinterpret_cast<destructor>(PyMultiSystem_dealloc);
+    PyMultiSystemType.tp_methods = PyMultiSystem_methods;
+    if (PyType_Ready(&PyMultiSystemType) < 0)
+        return nullptr;
+
+    PyObject* module = PyModule_Create(&moduleDef);
+    if (!module)
+        return nullptr;
+    Py_INCREF(&PyMultiSystemType);
+    if (PyModule_AddObject(module, "MultiMechanicalSystem", reinterpret_cast<PyObject*>(&PyMultiSystemType)) < 0) {
+        Py_DECREF(&PyMultiSystemType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
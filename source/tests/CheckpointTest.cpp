@@ -0,0 +1,132 @@
+// Checks that a run resumed from a checkpoint matches an uninterrupted one byte
+// for byte, and that a log ending in a torn record (crash during an append)
+// can be restored, checkpointed and restored again.
+// Run with `scons test`.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../MultiMechanicalSystem.h"
+
+namespace {
+
+int failures = 0;
+
+const std::string checkpointPath = "checkpoint_test.ckpt";
+const float T = 2.0f, h = 0.001f;
+
+MultiMechanicalSystem coupledChain() {
+    MultiMechanicalSystem system({1.0f, 2.0f, 3.0f}, {0.1f, 0.2f, 0.1f}, {1.0f, 1.0f, 2.0f},
+                                 {-0.9f, -0.3f, 0.4f}, {0.0f, 0.0f, 0.0f}, {{0, 1}, {1, 2}}, {1.0f, 1.0f});
+    ForceSchedule forces;
+    forces.addImpulse(0, 0.5f, 1.0f);
+    forces.addSinusoid(2, 0.3f, 4.0f);
+    system.setForceSchedule(forces);
+    return system;
+}
+
+// Anything that loads with a checkpoint will do; loadState replaces all of it
+MultiMechanicalSystem placeholder() {
+    return MultiMechanicalSystem({1.0f}, {0.0f}, {0.0f}, {0.0f}, {0.0f}, {}, {});
+}
+
+// Parameters, run state and the whole trajectory, for byte comparison
+std::vector<char> everything(const MultiMechanicalSystem& system) {
+    CheckpointBlob blob;
+    system.saveState(blob);
+    system.saveSamples(blob, 0);
+    return std::vector<char>(blob.data(), blob.data() + blob.size());
+}
+
+// Checkpoint as AsyncCheckpointWriter lays it out: samples since firstStep appended to the log, then the state
+void writeCheckpoint(const MultiMechanicalSystem& system, size_t firstStep) {
+    CheckpointBlob state, samples;
+    system.saveState(state);
+    system.saveSamples(samples, firstStep);
+    state.seal();
+    samples.seal();
+    appendCheckpointLog(checkpointLogPath(checkpointPath), samples, firstStep == 0, 0);
+    saveCheckpointFile(checkpointPath, state);
+}
+
+MultiMechanicalSystem restore() {
+    std::vector<char> data = loadCheckpointFile(checkpointPath);
+    CheckpointReader reader(data.data(), data.size());
+    MultiMechanicalSystem system = placeholder();
+    system.loadState(reader, loadCheckpointFile(checkpointLogPath(checkpointPath)));
+    return system;
+}
+
+void expect(bool ok, const char* what) {
+    if (!ok) {
+        std::printf("FAIL %s\n", what);
+        ++failures;
+    }
+}
+
+void resumeMatchesUninterrupted(const std::vector<char>& reference) {
+    // Stop mid-step-sequence, after the impulse cursor and sinusoid phase have moved
+    MultiMechanicalSystem interrupted = coupledChain();
+    interrupted.beginSimulation(T, h);
+    interrupted.advance(137);
+    writeCheckpoint(interrupted, 0);
+
+    MultiMechanicalSystem resumed = restore();
+    resumed.advance(MultiMechanicalSystem::numSteps(T, h));
+    expect(everything(resumed) == reference, "resumed run differs from the uninterrupted run");
+
+    // Same through the checkpointing driver, restored once more from its final snapshot
+    MultiMechanicalSystem driven = restore();
+    {
+        AsyncCheckpointWriter checkpoints(checkpointPath);
+        driven.resume(checkpoints, 250);
+    }
+    expect(everything(driven) == reference, "resume() differs from the uninterrupted run");
+    expect(everything(restore()) == reference, "final checkpoint differs from the uninterrupted run");
+}
+
+void tornLogRecord(const std::vector<char>& reference) {
+    MultiMechanicalSystem interrupted = coupledChain();
+    interrupted.beginSimulation(T, h);
+    interrupted.advance(500);
+    writeCheckpoint(interrupted, 0);
+
+    // Crash halfway through appending the next record
+    interrupted.advance(300);
+    CheckpointBlob torn;
+    interrupted.saveSamples(torn, 500);
+    torn.seal();
+    std::ofstream(checkpointLogPath(checkpointPath), std::ios::binary | std::ios::app).write(torn.data(), torn.size() / 2);
+
+    try {
+        MultiMechanicalSystem resumed = restore();
+        {
+            AsyncCheckpointWriter checkpoints(checkpointPath);
+            resumed.resume(checkpoints, 400);
+        }
+        expect(everything(restore()) == reference, "restore after a torn log record differs from the uninterrupted run");
+    } catch (const std::exception& e) {
+        std::printf("FAIL restore after a torn log record: %s\n", e.what());
+        ++failures;
+    }
+}
+
+} // namespace
+
+int main() {
+    MultiMechanicalSystem uninterrupted = coupledChain();
+    uninterrupted.simulate(T, h);
+    std::vector<char> reference = everything(uninterrupted);
+
+    resumeMatchesUninterrupted(reference);
+    tornLogRecord(reference);
+
+    std::remove(checkpointPath.c_str());
+    std::remove(checkpointLogPath(checkpointPath).c_str());
+    if (failures == 0)
+        std::printf("CheckpointTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
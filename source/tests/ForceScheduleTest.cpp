@@ -0,0 +1,75 @@
+// Checks that impulses are applied exactly once, including impulses that land
+// on a step boundary where (k - 1) * h + h and k * h round differently, and
+// that clearing a schedule removes its forces.
+// Run with `scons test`.
+
+#include <cstdio>
+#include <vector>
+
+#include "../MultiMechanicalSystem.h"
+
+namespace {
+
+int failures = 0;
+
+// Free unit mass (k = c = 0): a 1 N*s impulse must leave v == 1 exactly
+MultiMechanicalSystem freeMass(float impulseTime) {
+    MultiMechanicalSystem system({1.0f}, {0.0f}, {0.0f}, {0.0f}, {0.0f}, {}, {});
+    ForceSchedule forces;
+    forces.addImpulse(0, impulseTime, 1.0f);
+    system.setForceSchedule(forces);
+    return system;
+}
+
+void expectVelocity(float v, const char* driver, float impulseTime, float h) {
+    if (v != 1.0f) {
+        std::printf("FAIL %s: impulse at %g, h = %g gives v = %g\n", driver, impulseTime, h, v);
+        ++failures;
+    }
+}
+
+} // namespace
+
+int main() {
+    const float timeSteps[] = {0.001f, 0.01f, 0.02f, 0.05f, 0.1f, 0.016f};
+    for (float h : timeSteps) {
+        for (int k = 1; k < 200; ++k) {
+            // Boundary as simulate() computes it, and as an accumulated clock reaches it
+            float onBoundary = k * h;
+            float T = (k + 5) * h;
+
+            MultiMechanicalSystem batch = freeMass(onBoundary);
+            size_t steps = MultiMechanicalSystem::numSteps(T, h);
+            std::vector<float> x(steps), v(steps);
+            batch.simulateInto(T, h, x.data(), v.data());
+            expectVelocity(v[steps - 1], "simulateInto", onBoundary, h);
+
+            // Interactive driver in main.cpp: simTime += timeStep
+            MultiMechanicalSystem interactive = freeMass(onBoundary);
+            std::vector<float> y = {0.0f, 0.0f};
+            float simTime = 0.0f;
+            for (int s = 0; s < k + 5; ++s) {
+                y = interactive.step(simTime, y, h);
+                simTime += h;
+            }
+            expectVelocity(y[1], "accumulated clock", onBoundary, h);
+        }
+    }
+
+    // Replacing a step force with an empty schedule must stop it acting
+    MultiMechanicalSystem cleared({1.0f}, {0.0f}, {0.0f}, {0.0f}, {0.0f}, {}, {});
+    ForceSchedule push;
+    push.addStep(0, 0.0f, 1.0f);
+    cleared.setForceSchedule(push);
+    std::vector<float> y = cleared.step(0.0f, {0.0f, 0.0f}, 0.5f);
+    cleared.setForceSchedule(ForceSchedule());
+    std::vector<float> after = cleared.step(0.5f, y, 0.5f);
+    if (after[1] != y[1]) {
+        std::printf("FAIL cleared schedule: v went from %g to %g\n", y[1], after[1]);
+        ++failures;
+    }
+
+    if (failures == 0)
+        std::printf("ForceScheduleTest passed\n");
+    return failures == 0 ? 0 : 1;
+}